@@ -38,6 +38,8 @@ FluidCompleter::FluidCompleter(QObject *parent)
                   "ladspa_stop",
                   "legatomode",
                   "load",
+                  "midifilter",
+                  "midiflood",
                   "noteoff",
                   "noteon",
                   "pitch_bend",
@@ -63,6 +65,7 @@ FluidCompleter::FluidCompleter(QObject *parent)
                   "rev_setlevel",
                   "rev_setroomsize",
                   "rev_setwidth",
+                  "rtreport",
                   "router_begin",
                   "router_chan",
                   "router_clear",
@@ -78,6 +81,7 @@ FluidCompleter::FluidCompleter(QObject *parent)
                   "setportamentomode",
                   "settings",
                   "settuning",
+                  "sfmem",
                   "sleep",
                   "source",
                   "tune",
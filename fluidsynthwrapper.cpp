@@ -1,27 +1,69 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
 
+#include <QCoreApplication>
 #include <QDebug>
 #include <QFileInfo>
+#include <QHash>
+#include <QLocale>
+#include <QMutex>
+#include <QThread>
 #include <QTimer>
 
+#include <memory>
+#include <vector>
+
 #include "fluidsynthwrapper.h"
+#include "midiinputfilter.h"
+#include "programscanner.h"
+#include "soundfontcache.h"
+#include "soundfontinfo.h"
+#include "stemexporter.h"
+
+/* the FluidSynth log functions are global: messages go to the active session */
+static QMutex FluidSynthWrapper_log_mutex;
+static FluidSynthWrapper *FluidSynthWrapper_log_target = nullptr;
+static int FluidSynthWrapper_instances = 0;
 
 static void FluidSynthWrapper_log_function(int level, const char *message, void *data)
 {
-    FluidSynthWrapper *classInstance = static_cast<FluidSynthWrapper *>(data);
+    Q_UNUSED(data)
+    QMutexLocker locker(&FluidSynthWrapper_log_mutex);
+    FluidSynthWrapper *classInstance = FluidSynthWrapper_log_target;
+    if (classInstance == nullptr) {
+        fluid_default_log_function(level, message, nullptr);
+        return;
+    }
     emit classInstance->diagnostics(level, QByteArray(message));
 }
 
-void FluidSynthWrapper::init(const QString &audioDriver,
-                             const QString &midiDriver,
-                             const QString &configFile,
-                             const QStringList &args)
+static int FluidSynthWrapper_audio_callback(
+    void *data, int len, int nfx, float *fx[], int nout, float *out[])
+{
+    FluidSynthWrapper *classInstance = static_cast<FluidSynthWrapper *>(data);
+    return classInstance->processAudio(len, nfx, fx, nout, out);
+}
+
+static int FluidSynthWrapper_midi_callback(void *data, fluid_midi_event_t *event)
+{
+    FluidSynthWrapper *classInstance = static_cast<FluidSynthWrapper *>(data);
+    return classInstance->handleMidiInput(event);
+}
+
+void FluidSynthWrapper::makeLogTarget()
+{
+    QMutexLocker locker(&FluidSynthWrapper_log_mutex);
+    FluidSynthWrapper_log_target = this;
+}
+
+void FluidSynthWrapper::init(const SessionOptions &options)
 {
-    //fluid_set_log_function(fluid_log_level::FLUID_DBG, &FluidSynthWrapper_log_function, this);
-    fluid_set_log_function(fluid_log_level::FLUID_ERR, &FluidSynthWrapper_log_function, this);
-    fluid_set_log_function(fluid_log_level::FLUID_WARN, &FluidSynthWrapper_log_function, this);
-    fluid_set_log_function(fluid_log_level::FLUID_INFO, &FluidSynthWrapper_log_function, this);
+    //fluid_set_log_function(fluid_log_level::FLUID_DBG, &FluidSynthWrapper_log_function, nullptr);
+    fluid_set_log_function(fluid_log_level::FLUID_ERR, &FluidSynthWrapper_log_function, nullptr);
+    fluid_set_log_function(fluid_log_level::FLUID_WARN, &FluidSynthWrapper_log_function, nullptr);
+    fluid_set_log_function(fluid_log_level::FLUID_INFO, &FluidSynthWrapper_log_function, nullptr);
+    makeLogTarget();
+    const QString &configFile = options.configFile;
 
     m_settings = new_fluid_settings();
     fluid_settings_setint(m_settings, "midi.autoconnect", 1);
@@ -63,15 +105,27 @@ void FluidSynthWrapper::init(const QString &audioDriver,
         m_cmd_handler = nullptr;
     }
 
-    if (!audioDriver.isNull()) {
-        const QByteArray audioDriver_utf8 = audioDriver.toUtf8();
+    applySettings(options.settings);
+
+    /* the sessions after the first are independent instruments, with their own ports */
+    if (options.session > 1) {
+        applySessionSettings(options.session);
+    }
+
+    m_realtime = options.realtime;
+    if (m_realtime) {
+        applyRealtimeSettings();
+    }
+
+    if (!options.audioDriver.isNull()) {
+        const QByteArray audioDriver_utf8 = options.audioDriver.toUtf8();
         if (fluid_settings_setstr(m_settings, "audio.driver", audioDriver_utf8.data()) != FLUID_OK) {
             return;
         }
     }
 
-    if (!midiDriver.isNull()) {
-        const QByteArray midiDriver_utf8 = midiDriver.toUtf8();
+    if (!options.midiDriver.isNull()) {
+        const QByteArray midiDriver_utf8 = options.midiDriver.toUtf8();
         if (fluid_settings_setstr(m_settings, "midi.driver", midiDriver_utf8.data()) != FLUID_OK) {
             return;
         }
@@ -82,14 +136,18 @@ void FluidSynthWrapper::init(const QString &audioDriver,
         fluid_log(FLUID_WARN, "Failed to create the synthesizer");
         return;
     }
+    /* with dynamic sample loading the sample data is not shared among synths */
+    if (!dynamicSampleLoading()) {
+        SoundFontCache::instance()->addSynth(m_synth);
+    }
 
-    foreach (const auto fileName, args) {
+    foreach (const auto fileName, options.args) {
         fileName_utf8 = fileName.toUtf8();
         if (fluid_is_midifile(fileName_utf8.data())) {
             continue;
         }
         if (fluid_is_soundfont(fileName_utf8.data())) {
-            if (fluid_synth_sfload(m_synth, fileName_utf8.data(), 1) == -1) {
+            if (fluid_synth_sfload(m_synth, fileName_utf8.data(), 1) == FLUID_FAILED) {
                 fluid_log(FLUID_WARN, "Failed to load the SoundFont %s", fileName.toUtf8().data());
             }
         } else {
@@ -122,9 +180,22 @@ void FluidSynthWrapper::init(const QString &audioDriver,
 
     /* start the midi router and link it to the synth */
     if (m_router != nullptr) {
-        m_midi_driver = new_fluid_midi_driver(m_settings,
-                                              fluid_midi_router_handle_midi_event,
-                                              (void *) m_router);
+        handle_midi_event_func_t handler = fluid_midi_router_handle_midi_event;
+        void *handlerData = m_router;
+        if (options.coalesceMidi) {
+            m_midiFilter = std::make_unique<MidiInputFilter>(m_router,
+                                                             fluid_synth_count_midi_channels(
+                                                                 m_synth));
+            handler = MidiInputFilter::handle_midi_event;
+            handlerData = m_midiFilter.get();
+        }
+        if (m_realtime) {
+            m_midiHandler = handler;
+            m_midiHandlerData = handlerData;
+            handler = FluidSynthWrapper_midi_callback;
+            handlerData = this;
+        }
+        m_midi_driver = new_fluid_midi_driver(m_settings, handler, handlerData);
 
         if (m_midi_driver == nullptr) {
             fluid_log(FLUID_WARN,
@@ -137,7 +208,7 @@ void FluidSynthWrapper::init(const QString &audioDriver,
     /* create the player and add any midi files, if requested */
     createMidiPlayer();
     QStringList midiFiles;
-    foreach (const auto fileName, args) {
+    foreach (const auto fileName, options.args) {
         QByteArray file = fileName.toUtf8();
         if (fluid_is_midifile(file.data())) {
             midiFiles.append(fileName);
@@ -153,7 +224,26 @@ void FluidSynthWrapper::init(const QString &audioDriver,
         return;
     }
 
-    m_audio_driver = new_fluid_audio_driver(m_settings, m_synth);
+    if (m_realtime) {
+        prefaultBuffers();
+    }
+
+    /* the MIDI input filter is woken up, and the audio thread probed, once per audio period */
+    if (m_midiFilter || m_realtime) {
+        m_audio_driver = new_fluid_audio_driver2(m_settings, FluidSynthWrapper_audio_callback, this);
+        m_audioCallback = m_audio_driver != nullptr;
+        if (m_audio_driver == nullptr) {
+            fluid_log(FLUID_WARN,
+                      "The audio driver does not support a processing callback;\n"
+                      "MIDI input coalescing and audio thread verification are disabled.");
+            if (m_midiFilter) {
+                m_midiFilter->setCoalescing(false);
+            }
+        }
+    }
+    if (m_audio_driver == nullptr) {
+        m_audio_driver = new_fluid_audio_driver(m_settings, m_synth);
+    }
     if (m_audio_driver == nullptr) {
         fluid_log(FLUID_WARN, "Failed to create the audio driver. Giving up.");
         return;
@@ -161,22 +251,46 @@ void FluidSynthWrapper::init(const QString &audioDriver,
     
     fluid_log(FLUID_INFO, "FluidSynth runtime version %s", fluid_version_str());
     
-    QTimer::singleShot(100, this, &FluidSynthWrapper::initialized);
+    QTimer::singleShot(100, this, [=] {
+        if (m_realtime) {
+            emit dataRead(realtimeReport(), 0);
+        }
+        emit initialized();
+    });
 }
 
 void FluidSynthWrapper::deinit()
 {
-    //fluid_set_log_function(fluid_log_level::FLUID_DBG, fluid_default_log_function, nullptr);
-    fluid_set_log_function(fluid_log_level::FLUID_ERR, fluid_default_log_function, nullptr);
-    fluid_set_log_function(fluid_log_level::FLUID_WARN, fluid_default_log_function, nullptr);
-    fluid_set_log_function(fluid_log_level::FLUID_INFO, fluid_default_log_function, nullptr);
-    
+    {
+        QMutexLocker locker(&FluidSynthWrapper_log_mutex);
+        if (FluidSynthWrapper_log_target == this) {
+            FluidSynthWrapper_log_target = nullptr;
+        }
+    }
+    if (FluidSynthWrapper_instances == 0) {
+        //fluid_set_log_function(fluid_log_level::FLUID_DBG, fluid_default_log_function, nullptr);
+        fluid_set_log_function(fluid_log_level::FLUID_ERR, fluid_default_log_function, nullptr);
+        fluid_set_log_function(fluid_log_level::FLUID_WARN, fluid_default_log_function, nullptr);
+        fluid_set_log_function(fluid_log_level::FLUID_INFO, fluid_default_log_function, nullptr);
+    }
+
     delete_fluid_cmd_handler(m_cmd_handler);
 
+    if (m_floodThread) {
+        m_midiFilter->stopFlood();
+        m_floodThread->wait();
+    }
+    /* a cancelled export removes its incomplete stems */
+    if (m_exportThread) {
+        m_exporter->abort();
+        m_exportThread->wait();
+    }
     destroyMidiPlayer();
     delete_fluid_audio_driver(m_audio_driver);
     delete_fluid_midi_driver(m_midi_driver);
+    m_midiFilter.reset();
     delete_fluid_midi_router(m_router);
+    SoundFontCache::instance()->removeSynth(m_synth);
     delete_fluid_synth(m_synth);
     delete_fluid_settings(m_settings);
 }
@@ -184,6 +298,7 @@ void FluidSynthWrapper::deinit()
 FluidSynthWrapper::FluidSynthWrapper(QObject *parent)
     : QObject{parent}
 {
+    ++FluidSynthWrapper_instances;
     auto res = PipeNew(m_pipefds);
     Q_ASSERT_X(res == 0, "FluidSynthWrapper", "Error creating the pipe");
     PipeNonBlock(m_pipefds[FDREAD]);
@@ -197,6 +312,7 @@ FluidSynthWrapper::~FluidSynthWrapper()
 {
     PipeClose(m_pipefds[FDREAD]);
     PipeClose(m_pipefds[FDWRITE]);
+    --FluidSynthWrapper_instances;
     deinit();
 }
 
@@ -214,8 +330,34 @@ QByteArray FluidSynthWrapper::prompt() const
     return "> ";
 }
 
+bool FluidSynthWrapper::dynamicSampleLoading() const
+{
+    int value = 0;
+    if (m_settings) {
+        fluid_settings_getint(m_settings, "synth.dynamic-sample-loading", &value);
+    }
+    return value != 0;
+}
+
 void FluidSynthWrapper::command(const QByteArray &cmd)
 {
+    const QList<QByteArray> words = cmd.simplified().split(' ');
+    if (words.first() == "sfmem") {
+        emit dataRead(memoryReport(words.value(1) == "all"), 0);
+        return;
+    }
+    if (words.first() == "midifilter") {
+        emit dataRead(midiFilterReport(words.value(1) == "reset"), 0);
+        return;
+    }
+    if (words.first() == "rtreport") {
+        emit dataRead(realtimeReport(), 0);
+        return;
+    }
+    if (words.first() == "midiflood") {
+        startMidiFlood(words.value(1).toInt(), words.value(2).toInt());
+        return;
+    }
     if (m_cmd_handler && !cmd.isEmpty() && cmd != "\n") {
         m_cmdresult = fluid_command(m_cmd_handler, cmd.data(), m_pipefds[FDWRITE]);
         QTimer::singleShot(50, this, &FluidSynthWrapper::readyRead);
@@ -273,7 +415,434 @@ void FluidSynthWrapper::loadMIDIFiles(const QStringList &fileNames)
         }
     }
     if (!fileNames.isEmpty()) {
+        prewarmPresets(fileNames);
         fluid_player_play(m_player);
         emit midiPlayerActive();
     }
 }
+
+QStringList FluidSynthWrapper::soundFontFiles() const
+{
+    QStringList files;
+    if (m_synth != nullptr) {
+        /* the SoundFont stack is returned bottom first, in loading order */
+        for (int i = fluid_synth_sfcount(m_synth) - 1; i >= 0; --i) {
+            fluid_sfont_t *sfont = fluid_synth_get_sfont(m_synth, i);
+            if (sfont != nullptr) {
+                files << QString::fromUtf8(fluid_sfont_get_name(sfont));
+            }
+        }
+    }
+    return files;
+}
+
+void FluidSynthWrapper::exportStems(const QString &midiFile, const QString &directory, int groups)
+{
+    if (m_settings == nullptr || !fluid_is_midifile(midiFile.toUtf8().data())) {
+        fluid_log(FLUID_WARN, "Stem export: %s is not a MIDI file", midiFile.toUtf8().data());
+        emit stemsExported(false);
+        return;
+    }
+    if (m_exportThread) {
+        fluid_log(FLUID_WARN, "Stem export: an export is already running in this session");
+        emit stemsExported(false);
+        return;
+    }
+    auto exporter = std::make_shared<StemExporter>(m_settings, soundFontFiles(), groups);
+    auto success = std::make_shared<bool>(false);
+    m_exporter = exporter;
+    m_exportThread = QThread::create([=] { *success = exporter->render(midiFile, directory); });
+    connect(m_exportThread, &QThread::finished, this, [=] { emit stemsExported(*success); });
+    connect(m_exportThread, &QThread::finished, m_exportThread, &QObject::deleteLater);
+    m_exportThread->start(QThread::LowPriority);
+}
+
+void FluidSynthWrapper::applySessionSettings(int session)
+{
+    fluid_settings_setint(m_settings, "midi.autoconnect", 0);
+
+    const QByteArray portName = QString("FluidSynth Session %1").arg(session).toUtf8();
+    fluid_settings_setstr(m_settings, "midi.portname", portName.data());
+
+    const char *ids[]{"midi.alsa_seq.id", "midi.jack.id", "audio.jack.id"};
+    for (const char *name : ids) {
+        char *s = nullptr;
+        if (fluid_settings_dupstr(m_settings, name, &s) != FLUID_OK) {
+            continue;
+        }
+        QString base = QString::fromUtf8(s);
+        fluid_free(s);
+        if (base == "pid") {
+            base = QString::number(QCoreApplication::applicationPid());
+        }
+        const QByteArray id = QString("%1-%2").arg(base).arg(session).toUtf8();
+        fluid_settings_setstr(m_settings, name, id.data());
+    }
+}
+
+void FluidSynthWrapper::applySettings(const QStringList &settings)
+{
+    foreach (const auto &setting, settings) {
+        QByteArray name = setting.section('=', 0, 0).trimmed().toUtf8();
+        QByteArray value = setting.section('=', 1).trimmed().toUtf8();
+        int res = FLUID_FAILED;
+        switch (fluid_settings_get_type(m_settings, name.data())) {
+        case FLUID_NUM_TYPE:
+            res = fluid_settings_setnum(m_settings, name.data(), value.toDouble());
+            break;
+        case FLUID_INT_TYPE: {
+            const QByteArray v = value.toLower();
+            int i = (v == "yes" || v == "true" || v == "on") ? 1 : value.toInt();
+            res = fluid_settings_setint(m_settings, name.data(), i);
+            break;
+        }
+        case FLUID_STR_TYPE:
+            res = fluid_settings_setstr(m_settings, name.data(), value.data());
+            break;
+        default:
+            break;
+        }
+        if (res != FLUID_OK) {
+            fluid_log(FLUID_WARN, "Failed to set the setting: %s", setting.toUtf8().data());
+        }
+    }
+}
+
+void FluidSynthWrapper::prewarmPresets(const QStringList &midiFiles)
+{
+    if (m_synth == nullptr || !dynamicSampleLoading()) {
+        return;
+    }
+
+    foreach (const auto &p, m_pinned) {
+        fluid_synth_unpin_preset(m_synth, p.sfontId, p.bank, p.program);
+    }
+    m_pinned.clear();
+
+    char *mode = nullptr;
+    QByteArray bankSelect("gs");
+    if (fluid_settings_dupstr(m_settings, "synth.midi-bank-select", &mode) == FLUID_OK) {
+        bankSelect = mode;
+        fluid_free(mode);
+    }
+    const auto style = ProgramScanner::bankSelect(bankSelect);
+
+    /* pinned presets keep their samples loaded, even after a synth reset */
+    foreach (const auto &fileName, midiFiles) {
+        foreach (const auto &s, ProgramScanner::scan(fileName, style)) {
+            for (int i = 0; i < fluid_synth_sfcount(m_synth); ++i) {
+                fluid_sfont_t *sfont = fluid_synth_get_sfont(m_synth, i);
+                if (fluid_sfont_get_preset(sfont, s.bank, s.program) == nullptr) {
+                    continue;
+                }
+                const PinnedPreset p{fluid_sfont_get_id(sfont), s.bank, s.program};
+                if (!m_pinned.contains(p)
+                    && fluid_synth_pin_preset(m_synth, p.sfontId, p.bank, p.program)
+                           == FLUID_OK) {
+                    m_pinned << p;
+                }
+                break;
+            }
+        }
+    }
+    fluid_log(FLUID_INFO, "Prewarmed %d presets", int(m_pinned.size()));
+}
+
+QByteArray FluidSynthWrapper::memoryReport(bool allPresets)
+{
+    QByteArray report;
+    if (m_synth == nullptr) {
+        return report;
+    }
+    const QLocale locale;
+    const bool dynamic = dynamicSampleLoading();
+
+    /* presets currently selected on any channel or pinned, by SoundFont id */
+    QHash<int, QList<QPair<int, int>>> selected;
+    for (int chan = 0; chan < fluid_synth_count_midi_channels(m_synth); ++chan) {
+        fluid_preset_t *preset = fluid_synth_get_channel_preset(m_synth, chan);
+        if (preset != nullptr) {
+            auto &list = selected[fluid_sfont_get_id(fluid_preset_get_sfont(preset))];
+            auto p = qMakePair(fluid_preset_get_banknum(preset), fluid_preset_get_num(preset));
+            if (!list.contains(p)) {
+                list << p;
+            }
+        }
+    }
+    foreach (const auto &p, m_pinned) {
+        auto &list = selected[p.sfontId];
+        if (!list.contains(qMakePair(p.bank, p.program))) {
+            list << qMakePair(p.bank, p.program);
+        }
+    }
+
+    quint64 total = 0;
+    report += QString("Dynamic sample loading: %1\n").arg(dynamic ? "on" : "off").toUtf8();
+    for (int i = fluid_synth_sfcount(m_synth) - 1; i >= 0; --i) {
+        fluid_sfont_t *sfont = fluid_synth_get_sfont(m_synth, i);
+        const int id = fluid_sfont_get_id(sfont);
+        const QString fileName = QString::fromUtf8(fluid_sfont_get_name(sfont));
+        report += QString("SoundFont %1: %2\n").arg(id).arg(fileName).toUtf8();
+
+        auto info = SoundFontCache::instance()->info(fileName);
+        if (!info) {
+            report += "  no sample accounting available for this file\n";
+            continue;
+        }
+
+        const auto presets = selected.value(id);
+        const quint64 resident = dynamic ? info->residentBytes(presets) : info->sampleDataBytes();
+        total += resident;
+        report += QString("  sample data: %1, resident: %2\n")
+                      .arg(locale.formattedDataSize(info->sampleDataBytes()),
+                           locale.formattedDataSize(resident))
+                      .toUtf8();
+        if (!dynamic) {
+            report += QString("  shared by %1 session(s)\n")
+                          .arg(SoundFontCache::instance()->users(fileName))
+                          .toUtf8();
+        }
+
+        foreach (const auto &p, info->presets()) {
+            const bool isSelected = presets.contains(qMakePair(p.bank, p.program));
+            if (allPresets || isSelected) {
+                report += QString("  %1 %2-%3 %4 %5\n")
+                              .arg(QChar(isSelected ? '*' : ' '))
+                              .arg(p.bank, 3, 10, QChar('0'))
+                              .arg(p.program, 3, 10, QChar('0'))
+                              .arg(p.name, -20)
+                              .arg(locale.formattedDataSize(info->presetBytes(p.bank, p.program)))
+                              .toUtf8();
+            }
+        }
+    }
+    report += QString("Total resident sample memory: %1\n")
+                  .arg(locale.formattedDataSize(total))
+                  .toUtf8();
+    return report;
+}
+
+int FluidSynthWrapper::processAudio(int len, int nfx, float *fx[], int nout, float *out[])
+{
+    if (m_realtime) {
+        m_audioProbe.probe();
+    }
+    if (m_midiFilter) {
+        m_midiFilter->periodElapsed();
+    }
+    return fluid_synth_process(m_synth, len, nfx, fx, nout, out);
+}
+
+QByteArray FluidSynthWrapper::midiFilterReport(bool reset)
+{
+    if (!m_midiFilter) {
+        return "MIDI input coalescing is not available. Use the --coalesce-midi option.\n";
+    }
+    QByteArray report = QString("MIDI input coalescing: %1\n"
+                                "  received: %2, coalesced: %3, forwarded: %4\n")
+                            .arg(m_midiFilter->coalescing() ? "on" : "off")
+                            .arg(m_midiFilter->received())
+                            .arg(m_midiFilter->coalesced())
+                            .arg(m_midiFilter->forwarded())
+                            .toUtf8();
+    if (reset) {
+        m_midiFilter->resetCounters();
+    }
+    return report;
+}
+
+void FluidSynthWrapper::startMidiFlood(int count, int channel)
+{
+    if (!m_midiFilter) {
+        emit dataRead(midiFilterReport(false), 1);
+        return;
+    }
+    if (m_floodThread) {
+        emit dataRead("A MIDI flood is already running.\n", 1);
+        return;
+    }
+    if (count <= 0) {
+        count = 10000;
+    }
+    count = qMin(count, MAX_FLOOD_EVENTS);
+    channel = qBound(0, channel, fluid_synth_count_midi_channels(m_synth) - 1);
+    emit dataRead(QString("Sending %1 controller events to channel %2\n")
+                      .arg(count)
+                      .arg(channel)
+                      .toUtf8(),
+                  0);
+    MidiInputFilter *filter = m_midiFilter.get();
+    m_floodThread = QThread::create([=] { filter->generateFlood(count, channel); });
+    connect(m_floodThread, &QThread::finished, this, [=] {
+        emit dataRead(midiFilterReport(false), 0);
+    });
+    connect(m_floodThread, &QThread::finished, m_floodThread, &QObject::deleteLater);
+    m_floodThread->start();
+}
+
+int FluidSynthWrapper::handleMidiInput(fluid_midi_event_t *event)
+{
+    m_midiProbe.probe();
+    return m_midiHandler(m_midiHandlerData, event);
+}
+
+void FluidSynthWrapper::applyRealtimeSettings()
+{
+    fluid_settings_setint(m_settings, "synth.lock-memory", 1);
+
+    /* a priority of 0 disables real-time scheduling, which this mode requests */
+    int audioPrio = 0, midiPrio = 0;
+    fluid_settings_getint(m_settings, "audio.realtime-prio", &audioPrio);
+    if (audioPrio <= 0) {
+        audioPrio = DEFAULT_AUDIO_PRIO;
+        fluid_settings_setint(m_settings, "audio.realtime-prio", audioPrio);
+        m_audioPrioDefaulted = true;
+    }
+    fluid_settings_getint(m_settings, "midi.realtime-prio", &midiPrio);
+    if (midiPrio <= 0) {
+        midiPrio = DEFAULT_MIDI_PRIO;
+        fluid_settings_setint(m_settings, "midi.realtime-prio", midiPrio);
+        m_midiPrioDefaulted = true;
+    }
+    const int requested = qMax(audioPrio, midiPrio);
+
+    quint64 soft, hard;
+    if (RealtimeReport::rtprioLimit(soft, hard) && soft < quint64(requested)
+        && !RealtimeReport::privileged()) {
+        fluid_log(FLUID_WARN,
+                  "RLIMIT_RTPRIO (%s) is lower than the requested priority (%d):\n"
+                  "real-time scheduling will probably be refused, and the audio\n"
+                  "and MIDI threads will run with normal priority.\n"
+                  "Raise rtprio for this user in /etc/security/limits.conf.",
+                  RealtimeReport::formatLimit(soft).toUtf8().data(),
+                  requested);
+    }
+}
+
+void FluidSynthWrapper::prefaultBuffers()
+{
+    /* render one silent period, so the synthesis buffers are paged in */
+    int period = 64;
+    fluid_settings_getint(m_settings, "audio.period-size", &period);
+    std::vector<float> left(period), right(period);
+    float *out[2]{left.data(), right.data()};
+    fluid_synth_process(m_synth, period, 0, nullptr, 2, out);
+
+    /*
+     * then lock them, and every page mapped later, like the stacks of the
+     * audio and MIDI threads, which are locked and populated when created.
+     * With a limited RLIMIT_MEMLOCK, locking the future mappings would make
+     * later allocations fail, so only the sample data is locked by FluidSynth.
+     */
+    const QLocale locale;
+    quint64 soft, hard;
+    const bool limited = RealtimeReport::memlockLimit(soft, hard)
+                         && soft != RealtimeReport::UNLIMITED && !RealtimeReport::privileged();
+    if (limited) {
+        m_memoryLock = QString("not locked: RLIMIT_MEMLOCK is %1")
+                           .arg(locale.formattedDataSize(soft));
+        const quint64 required = sampleDataBytes();
+        fluid_log(FLUID_WARN,
+                  "RLIMIT_MEMLOCK (%s) is limited: only the sample data (%s) is locked,\n"
+                  "%sthe other buffers and the thread stacks may be paged out.\n"
+                  "Set memlock to unlimited for this user in /etc/security/limits.conf.",
+                  locale.formattedDataSize(soft).toUtf8().data(),
+                  locale.formattedDataSize(required).toUtf8().data(),
+                  soft < required ? "but part of the samples will not be locked, and\n" : "and ");
+    } else if (RealtimeReport::lockAllMemory()) {
+        m_memoryLock = "locked, including future allocations";
+    } else {
+        m_memoryLock = "not locked: the memory locking request failed";
+        fluid_log(FLUID_WARN,
+                  "Failed to lock the process memory: the synthesis buffers\n"
+                  "and the thread stacks may be paged out.");
+    }
+}
+
+quint64 FluidSynthWrapper::sampleDataBytes() const
+{
+    quint64 bytes = 0;
+    foreach (const auto &fileName, soundFontFiles()) {
+        auto info = SoundFontCache::instance()->info(fileName);
+        if (info) {
+            bytes += info->sampleDataBytes();
+        }
+    }
+    return bytes;
+}
+
+QByteArray FluidSynthWrapper::realtimeReport()
+{
+    if (m_settings == nullptr) {
+        return QByteArray();
+    }
+    const QLocale locale;
+    QString report("Real-time verification report\n");
+
+    int lockMemory = 0;
+    fluid_settings_getint(m_settings, "synth.lock-memory", &lockMemory);
+    quint64 locked = 0;
+    report += QString("  synth.lock-memory: %1, sample data: %2, locked by the process: %3\n")
+                  .arg(lockMemory)
+                  .arg(locale.formattedDataSize(sampleDataBytes()))
+                  .arg(RealtimeReport::lockedBytes(locked) ? locale.formattedDataSize(locked)
+                                                           : QString("unknown"));
+    if (m_realtime) {
+        report += QString("  process memory: %1\n").arg(m_memoryLock);
+    }
+
+    auto threadReport = [&](const char *name,
+                            const char *setting,
+                            const RealtimeReport::ThreadProbe &probe,
+                            bool defaulted,
+                            const char *pending) {
+        int requested = 0;
+        fluid_settings_getint(m_settings, setting, &requested);
+        report += QString("  %1 thread: requested priority %2%3, ")
+                      .arg(name)
+                      .arg(requested)
+                      .arg(defaulted ? " (set by the real-time mode)" : "");
+        if (!probe.ready()) {
+            report += QString("%1\n").arg(pending);
+            return;
+        }
+        const auto info = probe.info();
+        report += QString("granted %1 priority %2")
+                      .arg(QString::fromLatin1(info.policy))
+                      .arg(info.priority);
+        if (requested > 0 && !info.realtime) {
+            report += " (fallback: normal scheduling)";
+        }
+        report += "\n";
+    };
+    threadReport("audio",
+                 "audio.realtime-prio",
+                 m_audioProbe,
+                 m_audioPrioDefaulted,
+                 !m_realtime       ? "not verified: real-time mode is off"
+                 : m_audioCallback ? "not verified yet: no audio period has been processed"
+                                   : "not verified: the audio driver has no processing callback");
+    threadReport("MIDI",
+                 "midi.realtime-prio",
+                 m_midiProbe,
+                 m_midiPrioDefaulted,
+                 m_realtime ? "not verified yet: waiting for the first MIDI input event"
+                            : "not verified: real-time mode is off");
+
+    quint64 soft, hard;
+    if (RealtimeReport::rtprioLimit(soft, hard)) {
+        report += QString("  RLIMIT_RTPRIO: soft %1, hard %2\n")
+                      .arg(RealtimeReport::formatLimit(soft), RealtimeReport::formatLimit(hard));
+    }
+    if (RealtimeReport::memlockLimit(soft, hard)) {
+        auto format = [&](quint64 value) {
+            return value == RealtimeReport::UNLIMITED ? QString("unlimited")
+                                                      : locale.formattedDataSize(value);
+        };
+        report += QString("  RLIMIT_MEMLOCK: soft %1, hard %2\n").arg(format(soft), format(hard));
+    }
+    if (RealtimeReport::privileged()) {
+        report += "  running with superuser privileges\n";
+    }
+    return report.toUtf8();
+}
@@ -6,6 +6,11 @@
 
 #include <QByteArray>
 #include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QThread>
+
+#include <memory>
 
 #define BUFFER_SIZE 16384
 #ifdef Q_OS_WINDOWS
@@ -32,27 +37,64 @@
 
 #include <fluidsynth.h>
 
+#include "realtimereport.h"
+
+class MidiInputFilter;
+class StemExporter;
+
+struct SessionOptions
+{
+    QString audioDriver;
+    QString midiDriver;
+    QString configFile;
+    QStringList args;
+    QStringList settings;
+    bool coalesceMidi{false};
+    bool realtime{false};
+    int session{1};
+};
+
+struct PinnedPreset
+{
+    int sfontId;
+    int bank;
+    int program;
+
+    bool operator==(const PinnedPreset &other) const
+    {
+        return sfontId == other.sfontId && bank == other.bank && program == other.program;
+    }
+};
+
 class FluidSynthWrapper : public QObject
 {
     Q_OBJECT
 
 public:
     enum PipeDescriptors { FDNULL = -1, FDREAD = 0, FDWRITE = 1 };
+    static constexpr int MAX_FLOOD_EVENTS = 1000000;
+    static constexpr int DEFAULT_AUDIO_PRIO = 60;
+    static constexpr int DEFAULT_MIDI_PRIO = 50;
 
     explicit FluidSynthWrapper(QObject *parent = nullptr);
     ~FluidSynthWrapper() override;
 
-    void init(const QString &audioDriver,
-              const QString &midiDriver,
-              const QString &configFile,
-              const QStringList &args);
+    void init(const SessionOptions &options);
+    void makeLogTarget();
 
     QByteArray prompt() const;
+    bool dynamicSampleLoading() const;
+    QByteArray memoryReport(bool allPresets);
+    QByteArray midiFilterReport(bool reset);
+    QByteArray realtimeReport();
+    int processAudio(int len, int nfx, float *fx[], int nout, float *out[]);
+    int handleMidiInput(fluid_midi_event_t *event);
 
 public slots:
     void command(const QByteArray &cmd);
     void readPipe();
     void loadMIDIFiles(const QStringList &fileNames);
+    void exportStems(const QString &midiFile, const QString &directory, int groups);
 
 signals:
     void readyRead();
@@ -60,11 +102,20 @@ signals:
     void midiPlayerActive();
     void diagnostics(int level, const QByteArray message);
     void dataRead(const QByteArray &data, const int res);
+    void stemsExported(bool success);
 
 private:
     void deinit();
     void createMidiPlayer();
     void destroyMidiPlayer();
+    QStringList soundFontFiles() const;
+    void applySettings(const QStringList &settings);
+    void applySessionSettings(int session);
+    void prewarmPresets(const QStringList &midiFiles);
+    void startMidiFlood(int count, int channel);
+    void applyRealtimeSettings();
+    void prefaultBuffers();
+    quint64 sampleDataBytes() const;
 
     fluid_settings_t *m_settings{nullptr};
     fluid_player_t *m_player{nullptr};
@@ -75,6 +126,20 @@ private:
     fluid_cmd_handler_t *m_cmd_handler{nullptr};
     int m_cmdresult{0};
     int m_pipefds[2]{FDNULL, FDNULL};
+    QList<PinnedPreset> m_pinned;
+    std::unique_ptr<MidiInputFilter> m_midiFilter;
+    QPointer<QThread> m_floodThread;
+    std::shared_ptr<StemExporter> m_exporter;
+    QPointer<QThread> m_exportThread;
+    bool m_realtime{false};
+    bool m_audioCallback{false};
+    bool m_audioPrioDefaulted{false};
+    bool m_midiPrioDefaulted{false};
+    QString m_memoryLock;
+    handle_midi_event_func_t m_midiHandler{nullptr};
+    void *m_midiHandlerData{nullptr};
+    RealtimeReport::ThreadProbe m_audioProbe;
+    RealtimeReport::ThreadProbe m_midiProbe;
 };
 
 #endif // FLUIDSYNTHWRAPPER_H
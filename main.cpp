@@ -29,19 +29,39 @@ int main(int argc, char *argv[])
                                            "The (optional) configuration file.",
                                            "config-file");
     parser.addOption(configurationOption);
+    QCommandLineOption settingOption({"o", "option"},
+                                     "Define a setting, e.g. synth.polyphony=64 (repeatable).",
+                                     "name=value");
+    parser.addOption(settingOption);
+    QCommandLineOption dynamicOption({"d", "dynamic-sample-loading"},
+                                     "Load sample data only for the selected presets.");
+    parser.addOption(dynamicOption);
+    QCommandLineOption coalesceOption({"c", "coalesce-midi"},
+                                      "Coalesce continuous controller MIDI input per audio period.");
+    parser.addOption(coalesceOption);
+    QCommandLineOption realtimeOption({"r", "realtime"},
+                                      "Lock the process memory and use real-time priorities.");
+    parser.addOption(realtimeOption);
     parser.addPositionalArgument("SoundFont", "Soundfont File [*.sf2]");
     parser.addPositionalArgument("MidiFile", "MIDI File [*.mid]");
     parser.process(app);
 
-    QString audioDriver = parser.isSet(audioDriverOption) ? parser.value(audioDriverOption)
+    SessionOptions options;
+    options.audioDriver = parser.isSet(audioDriverOption) ? parser.value(audioDriverOption)
                                                           : QString();
-    QString midiDriver = parser.isSet(midiDriverOption) ? parser.value(midiDriverOption)
+    options.midiDriver = parser.isSet(midiDriverOption) ? parser.value(midiDriverOption)
                                                         : QString();
-    QString configFile = parser.isSet(configurationOption) ? parser.value(configurationOption)
+    options.configFile = parser.isSet(configurationOption) ? parser.value(configurationOption)
                                                            : QString();
-    QStringList args = parser.positionalArguments();
+    options.args = parser.positionalArguments();
+    options.settings = parser.values(settingOption);
+    if (parser.isSet(dynamicOption)) {
+        options.settings << "synth.dynamic-sample-loading=1";
+    }
+    options.coalesceMidi = parser.isSet(coalesceOption);
+    options.realtime = parser.isSet(realtimeOption);
 
-    MainWindow w(audioDriver, midiDriver, configFile, args);
+    MainWindow w(options);
     w.show();
 
     return app.exec();
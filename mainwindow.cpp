@@ -5,106 +5,130 @@
 #include <QDebug>
 #include <QDropEvent>
 #include <QFileDialog>
-#include <QFont>
-#include <QFontDatabase>
+#include <QFileInfo>
 #include <QIcon>
+#include <QInputDialog>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMimeData>
+#include <QTabWidget>
 #include <QToolBar>
 
-#include "ConsoleWidget.h"
-#include "fluidcompleter.h"
 #include "fluidsynthwrapper.h"
 #include "mainwindow.h"
+#include "sessionwidget.h"
+#include "stemexporter.h"
 
-MainWindow::MainWindow(const QString &audioDriver,
-                       const QString &midiDriver,
-                       const QString &configFile,
-                       const QStringList &args,
-                       QWidget *parent)
+MainWindow::MainWindow(const SessionOptions &options, QWidget *parent)
     : QMainWindow{parent}
+    , m_options(options)
 {
-    m_client = new FluidSynthWrapper(this);
-    m_completer = new FluidCompleter(this);
-    m_console = new ConsoleWidget(this);
-    m_console->setCompleter(m_completer);
-    m_console->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
-    m_console->setAcceptDrops(false);
-    connect(m_client, &FluidSynthWrapper::dataRead, this, &MainWindow::consoleOutput);
-    connect(m_client, &FluidSynthWrapper::diagnostics, this, &MainWindow::diagnosticsOutput);
-    connect(m_client, &FluidSynthWrapper::initialized, this, &MainWindow::startInput);
-    connect(m_client, &FluidSynthWrapper::midiPlayerActive, this, [=] {
-        enableCommandButtons(true);
-    });
-    connect(m_console->device(), &QIODevice::readyRead, this, &MainWindow::consoleInput);
+    m_tabs = new QTabWidget(this);
+    m_tabs->setTabsClosable(true);
+    m_tabs->setDocumentMode(true);
+    connect(m_tabs, &QTabWidget::tabCloseRequested, this, &MainWindow::closeSession);
+    connect(m_tabs, &QTabWidget::currentChanged, this, &MainWindow::sessionChanged);
 
     QMenu *file = menuBar()->addMenu("&File");
+    file->addAction("&New Session", QKeySequence::AddTab, this, &MainWindow::newSession);
     file->addAction("&Open", QKeySequence::Open, this, &MainWindow::fileDialog);
+    m_exportAction = file->addAction("&Export Stems...", this, &MainWindow::exportStemsDialog);
+    file->addAction("&Close Session", QKeySequence::Close, this, [=] {
+        closeSession(m_tabs->currentIndex());
+    });
     file->addAction("E&xit", QKeySequence::Quit, this, &MainWindow::close);
 
+    QMenu *tools = menuBar()->addMenu("&Tools");
+    tools->addAction("SoundFont &Memory", this, [=] { currentSession()->runCommand("sfmem"); });
+
     m_bar = addToolBar("&commands");
     m_startAction = m_bar->addAction(QIcon::fromTheme(QIcon::ThemeIcon::MediaSeekBackward), "Back");
-    connect(m_startAction, &QAction::triggered, this, [=] { m_client->command("player_start"); });
+    connect(m_startAction, &QAction::triggered, this, [=] {
+        currentSession()->client()->command("player_start");
+    });
     m_stopAction = m_bar->addAction(QIcon::fromTheme(QIcon::ThemeIcon::MediaPlaybackPause), "Pause");
-    connect(m_stopAction, &QAction::triggered, this, [=] { m_client->command("player_stop"); });
+    connect(m_stopAction, &QAction::triggered, this, [=] {
+        currentSession()->client()->command("player_stop");
+    });
     m_contAction = m_bar->addAction(QIcon::fromTheme(QIcon::ThemeIcon::MediaPlaybackStart), "Cont");
-    connect(m_contAction, &QAction::triggered, this, [=] { m_client->command("player_cont"); });
+    connect(m_contAction, &QAction::triggered, this, [=] {
+        currentSession()->client()->command("player_cont");
+    });
     m_nextAction = m_bar->addAction(QIcon::fromTheme(QIcon::ThemeIcon::MediaSkipForward), "Next");
-    connect(m_nextAction, &QAction::triggered, this, [=] { m_client->command("player_next"); });
+    connect(m_nextAction, &QAction::triggered, this, [=] {
+        currentSession()->client()->command("player_next");
+    });
     enableCommandButtons(false);
 
     setWindowTitle("FluidSynth Command Window");
-    setCentralWidget(m_console);
+    setCentralWidget(m_tabs);
     setAcceptDrops(true);
 
-    m_client->init(audioDriver, midiDriver, configFile, args);
+    newSession();
+
+    /* the MIDI files are played only by the first session */
+    QStringList soundFonts;
+    foreach (const auto &fileName, m_options.args) {
+        if (!fluid_is_midifile(fileName.toUtf8().data())) {
+            soundFonts << fileName;
+        }
+    }
+    m_options.args = soundFonts;
 }
 
-void MainWindow::consoleOutput(const QByteArray &data, const int res)
+SessionWidget *MainWindow::currentSession() const
 {
-    if (res == 0) {
-        m_console->writeStdOut(QString::fromUtf8(data));
-    } else {
-        m_console->writeStdErr(QString::fromUtf8(data));
-    }
-    m_console->setMode(ConsoleWidget::Input);
+    return qobject_cast<SessionWidget *>(m_tabs->currentWidget());
 }
 
-void MainWindow::diagnosticsOutput(int level, const QByteArray message)
+void MainWindow::newSession()
 {
-    static const QMap<int, QByteArray> prefix{{fluid_log_level::FLUID_ERR, "Error"},
-                                              {fluid_log_level::FLUID_WARN, "Warning"},
-                                              {fluid_log_level::FLUID_INFO, "Information"},
-                                              {fluid_log_level::FLUID_DBG, "Debug"}};
-    QByteArray buffer(prefix[level]);
-    buffer.append(": ");
-    buffer.append(message);
-    buffer.append("\n");
-    if (level < fluid_log_level::FLUID_INFO) {
-        m_console->writeStdErr(QString::fromUtf8(buffer));
-    } else {
-        m_console->writeStdOut(QString::fromUtf8(buffer));
-    }
+    auto session = new SessionWidget(m_tabs);
+    connect(session, &SessionWidget::playerActivated, this, [=] {
+        if (session == currentSession()) {
+            enableCommandButtons(true);
+        }
+    });
+    connect(session, &SessionWidget::quitRequested, this, [=] {
+        closeSession(m_tabs->indexOf(session));
+    });
+    connect(session->client(), &FluidSynthWrapper::stemsExported, this, [=] {
+        m_exportSession = nullptr;
+        m_exportAction->setEnabled(true);
+    });
+    int index = m_tabs->addTab(session, QString("Session %1").arg(++m_sessionCount));
+    m_tabs->setCurrentIndex(index);
+    SessionOptions options = m_options;
+    options.session = m_sessionCount;
+    session->init(options);
 }
 
-void MainWindow::consoleInput()
+void MainWindow::closeSession(int index)
 {
-    QByteArray text = m_console->device()->readAll();
-    if (!text.isEmpty()) {
-        m_client->command(text);
-    }
-    if (text == "quit\n") {
+    if (m_tabs->count() <= 1) {
         close();
-    } else {
-        consoleOutput(m_client->prompt());
+        return;
+    }
+    QWidget *session = m_tabs->widget(index);
+    /* closing the session cancels its export, which is not notified */
+    if (session == m_exportSession) {
+        m_exportSession = nullptr;
+        m_exportAction->setEnabled(true);
     }
+    m_tabs->removeTab(index);
+    /* the session may be closed from a signal of its own console */
+    session->deleteLater();
 }
 
-void MainWindow::startInput()
+void MainWindow::sessionChanged(int index)
 {
-    m_console->writeStdOut("Type 'help' for help topics.\n");
-    consoleOutput(m_client->prompt());
+    Q_UNUSED(index)
+    /* the FluidSynth diagnostics are shown in the current session */
+    SessionWidget *session = currentSession();
+    if (session != nullptr) {
+        session->client()->makeLogTarget();
+        enableCommandButtons(session->playerActive());
+    }
 }
 
 void MainWindow::fileDialog()
@@ -118,6 +142,37 @@ void MainWindow::fileDialog()
     }
 }
 
+void MainWindow::exportStemsDialog()
+{
+    QString midiFile = QFileDialog::getOpenFileName(this,
+                                                    "Select the MIDI file to export",
+                                                    QDir::homePath(),
+                                                    "MIDI Songs (*.mid *.midi *.MID)");
+    if (midiFile.isEmpty()) {
+        return;
+    }
+    QString directory = QFileDialog::getExistingDirectory(this,
+                                                          "Select the stems destination folder",
+                                                          QFileInfo(midiFile).absolutePath());
+    if (directory.isEmpty()) {
+        return;
+    }
+    bool ok;
+    int groups = QInputDialog::getInt(this,
+                                      "Export Stems",
+                                      "Number of stems (MIDI channel N goes to stem N modulo stems):",
+                                      StemExporter::DEFAULT_GROUPS,
+                                      1,
+                                      StemExporter::MAX_GROUPS,
+                                      1,
+                                      &ok);
+    if (ok) {
+        m_exportAction->setEnabled(false);
+        m_exportSession = currentSession();
+        m_exportSession->client()->exportStems(midiFile, directory, groups);
+    }
+}
+
 void MainWindow::enableCommandButtons(bool enable)
 {
     foreach (QAction *a, m_bar->actions()) {
@@ -127,7 +182,7 @@ void MainWindow::enableCommandButtons(bool enable)
 
 void MainWindow::processFiles(const QStringList &files)
 {
-    m_client->loadMIDIFiles(files);
+    currentSession()->client()->loadMIDIFiles(files);
 }
 
 void MainWindow::dropEvent(QDropEvent *event)
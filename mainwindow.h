@@ -7,39 +7,40 @@
 #include <QMainWindow>
 #include <QObject>
 
-class ConsoleWidget;
-class FluidCompleter;
-class FluidSynthWrapper;
+#include "fluidsynthwrapper.h"
+
 class QAction;
+class QTabWidget;
 class QToolBar;
+class SessionWidget;
 
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
-    ConsoleWidget *m_console{nullptr};
-    FluidCompleter *m_completer{nullptr};
-    FluidSynthWrapper *m_client{nullptr};
+    QTabWidget *m_tabs{nullptr};
+    SessionOptions m_options;
+    int m_sessionCount{0};
 
     QAction *m_stopAction{nullptr};
     QAction *m_contAction{nullptr};
     QAction *m_nextAction{nullptr};
     QAction *m_startAction{nullptr};
+    QAction *m_exportAction{nullptr};
+    SessionWidget *m_exportSession{nullptr};
     QToolBar *m_bar{nullptr};
 
 public:
-    explicit MainWindow(const QString &audioDriver,
-                        const QString &midiDriver,
-                        const QString &configFile,
-                        const QStringList &args,
-                        QWidget *parent = nullptr);
+    explicit MainWindow(const SessionOptions &options, QWidget *parent = nullptr);
+
+    SessionWidget *currentSession() const;
 
 public slots:
-    void consoleOutput(const QByteArray &data, const int res = 0);
-    void diagnosticsOutput(int level, const QByteArray message);
-    void consoleInput();
-    void startInput();
+    void newSession();
+    void closeSession(int index);
+    void sessionChanged(int index);
     void fileDialog();
+    void exportStemsDialog();
     void enableCommandButtons(bool enable);
     void processFiles(const QStringList &files);
 
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include <QThread>
+
+#include "midiinputfilter.h"
+
+static const int FLOOD_BURST = 64;
+
+MidiInputFilter::MidiInputFilter(fluid_midi_router_t *router, int channels)
+    : m_router(router)
+    , m_channels(channels)
+{
+    m_event = new_fluid_midi_event();
+    m_pending.assign(m_channels * SLOT_COUNT, -1);
+    m_dirty.resize(m_channels);
+    for (auto &dirty : m_dirty) {
+        dirty.reserve(SLOT_COUNT);
+    }
+    m_flusher = QThread::create([this] { flushPending(); });
+    m_flusher->start(QThread::HighestPriority);
+}
+
+MidiInputFilter::~MidiInputFilter()
+{
+    m_stopping = true;
+    m_periods.release();
+    m_flusher->wait();
+    delete m_flusher;
+    delete_fluid_midi_event(m_event);
+}
+
+int MidiInputFilter::handle_midi_event(void *data, fluid_midi_event_t *event)
+{
+    return static_cast<MidiInputFilter *>(data)->handleEvent(event);
+}
+
+bool MidiInputFilter::isContinuous(int controller)
+{
+    switch (controller) {
+    case 0:  // bank select MSB
+    case 6:  // data entry MSB
+    case 32: // bank select LSB
+    case 38: // data entry LSB
+        return false;
+    default:
+        /* switches, RPN/NRPN and channel mode messages are kept in order */
+        return !(controller >= 64 && controller <= 69) && !(controller >= 96 && controller <= 101)
+               && controller < 120;
+    }
+}
+
+int MidiInputFilter::handleEvent(fluid_midi_event_t *event)
+{
+    ++m_received;
+    const int type = fluid_midi_event_get_type(event);
+    const int chan = fluid_midi_event_get_channel(event);
+    if (!m_coalescing) {
+        return forward(event);
+    }
+
+    int slot = -1;
+    int value = 0;
+    switch (type) {
+    case MIDI_CONTROL_CHANGE:
+        if (isContinuous(fluid_midi_event_get_control(event))) {
+            slot = fluid_midi_event_get_control(event);
+            value = fluid_midi_event_get_value(event);
+        }
+        break;
+    case MIDI_PITCH_BEND:
+        slot = PITCH_BEND_SLOT;
+        value = fluid_midi_event_get_pitch(event);
+        break;
+    case MIDI_CHANNEL_PRESSURE:
+        slot = CHANNEL_PRESSURE_SLOT;
+        value = fluid_midi_event_get_program(event);
+        break;
+    case MIDI_KEY_PRESSURE:
+        slot = KEY_PRESSURE_SLOT + (fluid_midi_event_get_key(event) & 0x7f);
+        value = fluid_midi_event_get_value(event);
+        break;
+    default:
+        break;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (type >= MIDI_SYSTEM) {
+        for (int c = 0; c < m_channels; ++c) {
+            flushChannel(c);
+        }
+        return forward(event);
+    }
+    if (chan < 0 || chan >= m_channels) {
+        return forward(event);
+    }
+    if (slot < 0 || !m_coalescing) {
+        flushChannel(chan);
+        return forward(event);
+    }
+    int &pending = m_pending[chan * SLOT_COUNT + slot];
+    if (pending < 0) {
+        m_dirty[chan].push_back(slot);
+    } else {
+        ++m_coalesced;
+    }
+    pending = value;
+    return FLUID_OK;
+}
+
+void MidiInputFilter::periodElapsed()
+{
+    /* called from the audio thread: only wakes up the flusher, without locking */
+    if (m_periods.available() == 0) {
+        m_periods.release();
+    }
+}
+
+void MidiInputFilter::flushPending()
+{
+    forever {
+        m_periods.acquire();
+        if (m_stopping) {
+            break;
+        }
+        QMutexLocker locker(&m_mutex);
+        for (int chan = 0; chan < m_channels; ++chan) {
+            flushChannel(chan);
+        }
+    }
+}
+
+void MidiInputFilter::flushChannel(int chan)
+{
+    auto &dirty = m_dirty[chan];
+    for (quint16 slot : dirty) {
+        int &pending = m_pending[chan * SLOT_COUNT + slot];
+        fluid_midi_event_set_channel(m_event, chan);
+        if (slot < PITCH_BEND_SLOT) {
+            fluid_midi_event_set_type(m_event, MIDI_CONTROL_CHANGE);
+            fluid_midi_event_set_control(m_event, slot);
+            fluid_midi_event_set_value(m_event, pending);
+        } else if (slot == PITCH_BEND_SLOT) {
+            fluid_midi_event_set_type(m_event, MIDI_PITCH_BEND);
+            fluid_midi_event_set_pitch(m_event, pending);
+        } else if (slot == CHANNEL_PRESSURE_SLOT) {
+            fluid_midi_event_set_type(m_event, MIDI_CHANNEL_PRESSURE);
+            fluid_midi_event_set_program(m_event, pending);
+        } else {
+            fluid_midi_event_set_type(m_event, MIDI_KEY_PRESSURE);
+            fluid_midi_event_set_key(m_event, slot - KEY_PRESSURE_SLOT);
+            fluid_midi_event_set_value(m_event, pending);
+        }
+        pending = -1;
+        forward(m_event);
+    }
+    dirty.clear();
+}
+
+int MidiInputFilter::forward(fluid_midi_event_t *event)
+{
+    ++m_forwarded;
+    return fluid_midi_router_handle_midi_event(m_router, event);
+}
+
+void MidiInputFilter::setCoalescing(bool enabled)
+{
+    QMutexLocker locker(&m_mutex);
+    m_coalescing = enabled;
+    if (!enabled) {
+        for (int chan = 0; chan < m_channels; ++chan) {
+            flushChannel(chan);
+        }
+    }
+}
+
+void MidiInputFilter::resetCounters()
+{
+    m_received = 0;
+    m_coalesced = 0;
+    m_forwarded = 0;
+}
+
+void MidiInputFilter::stopFlood()
+{
+    /* used on shutdown: the flood is not restarted */
+    m_floodStopped = true;
+}
+
+void MidiInputFilter::generateFlood(int count, int channel)
+{
+    fluid_midi_event_t *event = new_fluid_midi_event();
+    fluid_midi_event_set_channel(event, channel);
+    for (int i = 0; i < count && !m_floodStopped; ++i) {
+        switch (i % 3) {
+        case 0:
+            fluid_midi_event_set_type(event, MIDI_CONTROL_CHANGE);
+            fluid_midi_event_set_control(event, 1);
+            fluid_midi_event_set_value(event, i % 128);
+            break;
+        case 1:
+            fluid_midi_event_set_type(event, MIDI_PITCH_BEND);
+            fluid_midi_event_set_pitch(event, 8192 + (i % 1024) - 512);
+            break;
+        default:
+            fluid_midi_event_set_type(event, MIDI_CHANNEL_PRESSURE);
+            fluid_midi_event_set_program(event, i % 128);
+            break;
+        }
+        handleEvent(event);
+        if (i % FLOOD_BURST == FLOOD_BURST - 1) {
+            QThread::usleep(1000);
+        }
+    }
+    /* leave the channel in its default state */
+    fluid_midi_event_set_type(event, MIDI_CONTROL_CHANGE);
+    fluid_midi_event_set_control(event, 1);
+    fluid_midi_event_set_value(event, 0);
+    handleEvent(event);
+    fluid_midi_event_set_type(event, MIDI_PITCH_BEND);
+    fluid_midi_event_set_pitch(event, 8192);
+    handleEvent(event);
+    fluid_midi_event_set_type(event, MIDI_CHANNEL_PRESSURE);
+    fluid_midi_event_set_program(event, 0);
+    handleEvent(event);
+    delete_fluid_midi_event(event);
+}
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef MIDIINPUTFILTER_H
+#define MIDIINPUTFILTER_H
+
+#include <QMutex>
+#include <QSemaphore>
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+#include <fluidsynth.h>
+
+class QThread;
+
+/*
+ * Input stage between the MIDI driver and the MIDI router. Continuous
+ * controller, pitch bend and aftertouch updates are held until the next audio
+ * period, and only the latest value of each one is forwarded. Any other event
+ * passes through untouched, after the pending updates of its channel.
+ *
+ * The audio callback only signals the end of each period: the held updates
+ * are forwarded to the router by a flusher thread, so the audio thread never
+ * takes the router or synth locks. A held update is delivered between one and
+ * two audio periods after it arrives, plus the wake up time of the flusher.
+ */
+class MidiInputFilter
+{
+public:
+    enum MidiStatus {
+        MIDI_KEY_PRESSURE = 0xa0,
+        MIDI_CONTROL_CHANGE = 0xb0,
+        MIDI_CHANNEL_PRESSURE = 0xd0,
+        MIDI_PITCH_BEND = 0xe0,
+        MIDI_SYSTEM = 0xf0
+    };
+    enum PendingSlots {
+        PITCH_BEND_SLOT = 128,
+        CHANNEL_PRESSURE_SLOT = 129,
+        KEY_PRESSURE_SLOT = 130,
+        SLOT_COUNT = 258
+    };
+
+    MidiInputFilter(fluid_midi_router_t *router, int channels);
+    ~MidiInputFilter();
+
+    static int handle_midi_event(void *data, fluid_midi_event_t *event);
+    int handleEvent(fluid_midi_event_t *event);
+    void periodElapsed();
+    void generateFlood(int count, int channel);
+    void stopFlood();
+
+    void setCoalescing(bool enabled);
+    bool coalescing() const { return m_coalescing; }
+    quint64 received() const { return m_received; }
+    quint64 coalesced() const { return m_coalesced; }
+    quint64 forwarded() const { return m_forwarded; }
+    void resetCounters();
+
+private:
+    static bool isContinuous(int controller);
+    void flushPending();
+    void flushChannel(int chan);
+    int forward(fluid_midi_event_t *event);
+
+    fluid_midi_router_t *m_router{nullptr};
+    fluid_midi_event_t *m_event{nullptr};
+    int m_channels{16};
+    std::atomic<bool> m_coalescing{true};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_floodStopped{false};
+    QSemaphore m_periods;
+    QThread *m_flusher{nullptr};
+    QMutex m_mutex;
+    std::vector<int> m_pending;
+    std::vector<std::vector<quint16>> m_dirty;
+    std::atomic<quint64> m_received{0};
+    std::atomic<quint64> m_coalesced{0};
+    std::atomic<quint64> m_forwarded{0};
+};
+
+#endif // MIDIINPUTFILTER_H
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include <QByteArray>
+#include <QFile>
+#include <QtEndian>
+
+#include "programscanner.h"
+
+static const int MIDI_CHANNELS = 16;
+static const int DRUM_CHANNEL = 9;
+static const int XG_DRUM_MSB = 120;
+
+static quint32 readVarLen(const QByteArray &data, qsizetype &pos)
+{
+    quint32 value = 0;
+    for (int i = 0; i < 4 && pos < data.size(); ++i) {
+        quint8 c = data[pos++];
+        value = (value << 7) | (c & 0x7f);
+        if (!(c & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+ProgramScanner::BankSelect ProgramScanner::bankSelect(const QByteArray &style)
+{
+    if (style == "gm") {
+        return GM;
+    }
+    if (style == "xg") {
+        return XG;
+    }
+    if (style == "mma") {
+        return MMA;
+    }
+    return GS;
+}
+
+QList<ProgramScanner::Selection> ProgramScanner::scan(const QString &fileName, BankSelect style)
+{
+    QList<Selection> selections;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return selections;
+    }
+    const QByteArray data = file.readAll();
+    if (!data.startsWith("MThd")) {
+        return selections;
+    }
+
+    /* the channel state after a synth reset: channel 10 plays drums */
+    int bank[MIDI_CHANNELS]{};
+    bool drums[MIDI_CHANNELS]{};
+    drums[DRUM_CHANNEL] = true;
+    qsizetype chunk = 0;
+    while (chunk + 8 <= data.size()) {
+        const QByteArray chunkId = data.mid(chunk, 4);
+        const quint32 chunkSize = qFromBigEndian<quint32>(data.constData() + chunk + 4);
+        const qsizetype end = qMin<qsizetype>(data.size(), chunk + 8 + chunkSize);
+        qsizetype pos = chunk + 8;
+        chunk = end;
+        if (chunkId != "MTrk") {
+            continue;
+        }
+        quint8 status = 0;
+        while (pos < end) {
+            readVarLen(data, pos);
+            if (pos >= end) {
+                break;
+            }
+            quint8 c = data[pos];
+            if (c & 0x80) {
+                status = c;
+                ++pos;
+            }
+            if (status == 0xff) {
+                ++pos;
+                pos += readVarLen(data, pos);
+                status = 0;
+                continue;
+            }
+            if (status == 0xf0 || status == 0xf7) {
+                pos += readVarLen(data, pos);
+                status = 0;
+                continue;
+            }
+            if (status < 0x80 || pos >= end) {
+                break;
+            }
+            const int channel = status & 0x0f;
+            const quint8 type = status & 0xf0;
+            const quint8 data1 = data[pos];
+            if (type == 0xc0 || type == 0xd0) {
+                pos += 1;
+            } else {
+                pos += 2;
+            }
+            if (type == 0xb0 && pos <= end) {
+                const quint8 data2 = data[pos - 1];
+                if (data1 == 0) {
+                    /* XG switches the channel type; the other styles ignore it on drums */
+                    if (style == XG) {
+                        drums[channel] = data2 >= XG_DRUM_MSB;
+                    } else if (style != GM && !drums[channel]) {
+                        bank[channel] = (style == GS) ? data2
+                                                      : (bank[channel] & 0x7f) | (data2 << 7);
+                    }
+                } else if (data1 == 32) {
+                    if ((style == XG || style == MMA) && !drums[channel]) {
+                        bank[channel] = (style == XG) ? data2 : (bank[channel] & ~0x7f) | data2;
+                    }
+                }
+            } else if (type == 0xc0) {
+                Selection s{channel, drums[channel] ? DRUM_INST_BANK : bank[channel], data1};
+                if (!selections.contains(s)) {
+                    selections << s;
+                }
+            }
+        }
+    }
+    return selections;
+}
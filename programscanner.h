@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef PROGRAMSCANNER_H
+#define PROGRAMSCANNER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/*
+ * Minimal Standard MIDI File reader that collects the bank and program
+ * selections of a song, so the presets can be loaded before playback.
+ * The bank select messages and the drum channel switching are interpreted
+ * as the FluidSynth channels do, for the given synth.midi-bank-select style.
+ */
+class ProgramScanner
+{
+public:
+    static constexpr int DRUM_INST_BANK = 128;
+
+    enum BankSelect { GM, GS, XG, MMA };
+
+    struct Selection
+    {
+        int channel;
+        int bank;
+        int program;
+
+        bool operator==(const Selection &other) const
+        {
+            return channel == other.channel && bank == other.bank && program == other.program;
+        }
+    };
+
+    static BankSelect bankSelect(const QByteArray &style);
+    static QList<Selection> scan(const QString &fileName, BankSelect style);
+};
+
+#endif // PROGRAMSCANNER_H
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include <QFile>
+
+#ifdef Q_OS_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "realtimereport.h"
+
+RealtimeReport::ThreadInfo RealtimeReport::currentThread()
+{
+    ThreadInfo info;
+#ifdef Q_OS_WINDOWS
+    info.priority = GetThreadPriority(GetCurrentThread());
+    info.realtime = info.priority >= THREAD_PRIORITY_TIME_CRITICAL;
+    info.policy = "Windows thread priority";
+#else
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0) {
+        info.priority = param.sched_priority;
+        info.realtime = (policy == SCHED_FIFO || policy == SCHED_RR);
+        info.policy = policy == SCHED_FIFO ? "SCHED_FIFO"
+                      : policy == SCHED_RR ? "SCHED_RR"
+                                           : "SCHED_OTHER";
+    }
+#endif
+    return info;
+}
+
+bool RealtimeReport::lockAllMemory()
+{
+#ifdef Q_OS_WINDOWS
+    return false;
+#else
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#endif
+}
+
+bool RealtimeReport::lockedBytes(quint64 &bytes)
+{
+#ifdef Q_OS_LINUX
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        foreach (const auto &line, status.readAll().split('\n')) {
+            if (line.startsWith("VmLck:")) {
+                /* the value is reported in kB */
+                bytes = line.mid(6).simplified().split(' ').value(0).toULongLong() * 1024;
+                return true;
+            }
+        }
+    }
+#else
+    Q_UNUSED(bytes)
+#endif
+    return false;
+}
+
+#ifndef Q_OS_WINDOWS
+static bool RealtimeReport_limits(int resource, quint64 &soft, quint64 &hard)
+{
+    rlimit limit;
+    if (getrlimit(resource, &limit) != 0) {
+        return false;
+    }
+    soft = limit.rlim_cur == RLIM_INFINITY ? RealtimeReport::UNLIMITED : limit.rlim_cur;
+    hard = limit.rlim_max == RLIM_INFINITY ? RealtimeReport::UNLIMITED : limit.rlim_max;
+    return true;
+}
+#endif
+
+bool RealtimeReport::rtprioLimit(quint64 &soft, quint64 &hard)
+{
+#if defined(Q_OS_WINDOWS) || !defined(RLIMIT_RTPRIO)
+    Q_UNUSED(soft)
+    Q_UNUSED(hard)
+    return false;
+#else
+    return RealtimeReport_limits(RLIMIT_RTPRIO, soft, hard);
+#endif
+}
+
+bool RealtimeReport::memlockLimit(quint64 &soft, quint64 &hard)
+{
+#ifdef Q_OS_WINDOWS
+    Q_UNUSED(soft)
+    Q_UNUSED(hard)
+    return false;
+#else
+    return RealtimeReport_limits(RLIMIT_MEMLOCK, soft, hard);
+#endif
+}
+
+bool RealtimeReport::privileged()
+{
+#ifdef Q_OS_WINDOWS
+    return false;
+#else
+    return geteuid() == 0;
+#endif
+}
+
+QString RealtimeReport::formatLimit(quint64 value)
+{
+    return value == UNLIMITED ? QString("unlimited") : QString::number(value);
+}
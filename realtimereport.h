@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef REALTIMEREPORT_H
+#define REALTIMEREPORT_H
+
+#include <QString>
+
+#include <atomic>
+
+/*
+ * Helpers that verify the real-time settings really took effect: the
+ * scheduling of the audio and MIDI threads, the amount of locked memory and
+ * the resource limits that may refuse them.
+ */
+class RealtimeReport
+{
+public:
+    static constexpr quint64 UNLIMITED = ~quint64(0);
+
+    struct ThreadInfo
+    {
+        bool realtime{false};
+        int priority{0};
+        const char *policy{"unknown"};
+    };
+
+    /*
+     * records the scheduling of the first thread that calls probe(). It is
+     * called from the audio and MIDI callbacks, so it must not allocate.
+     */
+    class ThreadProbe
+    {
+    public:
+        void probe()
+        {
+            if (m_state.load(std::memory_order_relaxed) != NONE) {
+                return;
+            }
+            int expected = NONE;
+            if (m_state.compare_exchange_strong(expected, PROBING)) {
+                m_info = RealtimeReport::currentThread();
+                m_state.store(READY, std::memory_order_release);
+            }
+        }
+        bool ready() const { return m_state.load(std::memory_order_acquire) == READY; }
+        ThreadInfo info() const { return m_info; }
+
+    private:
+        enum { NONE, PROBING, READY };
+        std::atomic<int> m_state{NONE};
+        ThreadInfo m_info;
+    };
+
+    static ThreadInfo currentThread();
+    static bool lockAllMemory();
+    static bool lockedBytes(quint64 &bytes);
+    static bool rtprioLimit(quint64 &soft, quint64 &hard);
+    static bool memlockLimit(quint64 &soft, quint64 &hard);
+    static bool privileged();
+    static QString formatLimit(quint64 value);
+};
+
+#endif // REALTIMEREPORT_H
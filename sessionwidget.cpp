@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include <QFontDatabase>
+#include <QMap>
+#include <QVBoxLayout>
+
+#include "ConsoleWidget.h"
+#include "fluidcompleter.h"
+#include "fluidsynthwrapper.h"
+#include "sessionwidget.h"
+
+SessionWidget::SessionWidget(QWidget *parent)
+    : QWidget{parent}
+{
+    m_client = new FluidSynthWrapper(this);
+    m_completer = new FluidCompleter(this);
+    m_console = new ConsoleWidget(this);
+    m_console->setCompleter(m_completer);
+    m_console->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    m_console->setAcceptDrops(false);
+    connect(m_client, &FluidSynthWrapper::dataRead, this, &SessionWidget::consoleOutput);
+    connect(m_client, &FluidSynthWrapper::diagnostics, this, &SessionWidget::diagnosticsOutput);
+    connect(m_client, &FluidSynthWrapper::initialized, this, &SessionWidget::startInput);
+    connect(m_client, &FluidSynthWrapper::midiPlayerActive, this, [=] {
+        m_playerActive = true;
+        emit playerActivated();
+    });
+    connect(m_console->device(), &QIODevice::readyRead, this, &SessionWidget::consoleInput);
+
+    auto layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(m_console);
+}
+
+void SessionWidget::init(const SessionOptions &options)
+{
+    m_client->init(options);
+}
+
+void SessionWidget::consoleOutput(const QByteArray &data, const int res)
+{
+    if (res == 0) {
+        m_console->writeStdOut(QString::fromUtf8(data));
+    } else {
+        m_console->writeStdErr(QString::fromUtf8(data));
+    }
+    m_console->setMode(ConsoleWidget::Input);
+}
+
+void SessionWidget::diagnosticsOutput(int level, const QByteArray message)
+{
+    static const QMap<int, QByteArray> prefix{{fluid_log_level::FLUID_ERR, "Error"},
+                                              {fluid_log_level::FLUID_WARN, "Warning"},
+                                              {fluid_log_level::FLUID_INFO, "Information"},
+                                              {fluid_log_level::FLUID_DBG, "Debug"}};
+    QByteArray buffer(prefix[level]);
+    buffer.append(": ");
+    buffer.append(message);
+    buffer.append("\n");
+    if (level < fluid_log_level::FLUID_INFO) {
+        m_console->writeStdErr(QString::fromUtf8(buffer));
+    } else {
+        m_console->writeStdOut(QString::fromUtf8(buffer));
+    }
+}
+
+void SessionWidget::consoleInput()
+{
+    QByteArray text = m_console->device()->readAll();
+    if (!text.isEmpty()) {
+        m_client->command(text);
+    }
+    if (text == "quit\n") {
+        emit quitRequested();
+    } else {
+        consoleOutput(m_client->prompt());
+    }
+}
+
+void SessionWidget::startInput()
+{
+    m_console->writeStdOut("Type 'help' for help topics.\n");
+    consoleOutput(m_client->prompt());
+}
+
+void SessionWidget::runCommand(const QByteArray &cmd)
+{
+    m_console->writeStdOut(QString::fromUtf8(cmd) + "\n");
+    m_client->command(cmd);
+    consoleOutput(m_client->prompt());
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef SESSIONWIDGET_H
+#define SESSIONWIDGET_H
+
+#include <QObject>
+#include <QWidget>
+
+class ConsoleWidget;
+class FluidCompleter;
+class FluidSynthWrapper;
+struct SessionOptions;
+
+class SessionWidget : public QWidget
+{
+    Q_OBJECT
+
+    ConsoleWidget *m_console{nullptr};
+    FluidCompleter *m_completer{nullptr};
+    FluidSynthWrapper *m_client{nullptr};
+    bool m_playerActive{false};
+
+public:
+    explicit SessionWidget(QWidget *parent = nullptr);
+
+    void init(const SessionOptions &options);
+    FluidSynthWrapper *client() const { return m_client; }
+    bool playerActive() const { return m_playerActive; }
+
+public slots:
+    void consoleOutput(const QByteArray &data, const int res = 0);
+    void diagnosticsOutput(int level, const QByteArray message);
+    void consoleInput();
+    void startInput();
+    void runCommand(const QByteArray &cmd);
+
+signals:
+    void playerActivated();
+    void quitRequested();
+};
+
+#endif // SESSIONWIDGET_H
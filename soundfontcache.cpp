@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include "soundfontcache.h"
+#include "soundfontinfo.h"
+
+SoundFontCache *SoundFontCache::instance()
+{
+    static SoundFontCache cache;
+    return &cache;
+}
+
+void SoundFontCache::addSynth(fluid_synth_t *synth)
+{
+    if (synth != nullptr && !m_synths.contains(synth)) {
+        m_synths << synth;
+    }
+}
+
+void SoundFontCache::removeSynth(fluid_synth_t *synth)
+{
+    m_synths.removeAll(synth);
+    /* drop the accounting of the files no longer used by any session */
+    auto it = m_info.begin();
+    while (it != m_info.end()) {
+        if (users(it.key()) == 0) {
+            it = m_info.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool SoundFontCache::hasSoundFont(fluid_synth_t *synth, const QString &fileName)
+{
+    for (int i = 0; i < fluid_synth_sfcount(synth); ++i) {
+        fluid_sfont_t *sfont = fluid_synth_get_sfont(synth, i);
+        if (sfont != nullptr && fileName == QString::fromUtf8(fluid_sfont_get_name(sfont))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int SoundFontCache::users(const QString &fileName) const
+{
+    /* the SoundFont stacks also change with the load, unload and reload commands */
+    int count = 0;
+    foreach (auto synth, m_synths) {
+        if (hasSoundFont(synth, fileName)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+std::shared_ptr<SoundFontInfo> SoundFontCache::info(const QString &fileName)
+{
+    auto info = m_info.value(fileName);
+    if (!info) {
+        info = std::make_shared<SoundFontInfo>();
+        if (!info->load(fileName)) {
+            return nullptr;
+        }
+        m_info.insert(fileName, info);
+    }
+    return info;
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef SOUNDFONTCACHE_H
+#define SOUNDFONTCACHE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+#include <fluidsynth.h>
+
+class SoundFontInfo;
+
+/*
+ * Process wide registry of the SoundFonts used by the synth sessions.
+ * FluidSynth shares the sample data of SoundFonts loaded from the same file
+ * among all the synths of the process, unless dynamic sample loading is
+ * enabled. The registry counts the synths that currently have each file
+ * loaded, reading their SoundFont stacks, and caches the parsed sample
+ * accounting of the files while they are in use.
+ */
+class SoundFontCache
+{
+public:
+    static SoundFontCache *instance();
+
+    void addSynth(fluid_synth_t *synth);
+    void removeSynth(fluid_synth_t *synth);
+    int users(const QString &fileName) const;
+    std::shared_ptr<SoundFontInfo> info(const QString &fileName);
+
+private:
+    SoundFontCache() = default;
+    static bool hasSoundFont(fluid_synth_t *synth, const QString &fileName);
+
+    QList<fluid_synth_t *> m_synths;
+    QHash<QString, std::shared_ptr<SoundFontInfo>> m_info;
+};
+
+#endif // SOUNDFONTCACHE_H
@@ -0,0 +1,179 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include <QByteArray>
+#include <QFile>
+#include <QtEndian>
+
+#include "soundfontinfo.h"
+
+enum SF2Generators { GEN_INSTRUMENT = 41, GEN_SAMPLEID = 53 };
+enum SF2RecordSizes {
+    PHDR_SIZE = 38,
+    BAG_SIZE = 4,
+    GEN_SIZE = 4,
+    INST_SIZE = 22,
+    SHDR_SIZE = 46
+};
+static const quint16 ROM_SAMPLE = 0x8000;
+
+static quint16 readWord(const QByteArray &data, qsizetype offset)
+{
+    return qFromLittleEndian<quint16>(data.constData() + offset);
+}
+
+static quint32 readDWord(const QByteArray &data, qsizetype offset)
+{
+    return qFromLittleEndian<quint32>(data.constData() + offset);
+}
+
+/* Collects the generator amounts of type genOper in the zones [firstBag, lastBag) */
+static QVector<int> zoneTargets(const QByteArray &bags,
+                                const QByteArray &gens,
+                                int firstBag,
+                                int lastBag,
+                                quint16 genOper)
+{
+    QVector<int> targets;
+    for (int bag = firstBag; bag < lastBag; ++bag) {
+        if ((bag + 1) * BAG_SIZE + 2 > bags.size()) {
+            break;
+        }
+        int firstGen = readWord(bags, bag * BAG_SIZE);
+        int lastGen = readWord(bags, (bag + 1) * BAG_SIZE);
+        for (int gen = firstGen; gen < lastGen && (gen + 1) * GEN_SIZE <= gens.size(); ++gen) {
+            if (readWord(gens, gen * GEN_SIZE) == genOper) {
+                targets << readWord(gens, gen * GEN_SIZE + 2);
+            }
+        }
+    }
+    return targets;
+}
+
+bool SoundFontInfo::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QByteArray header = file.read(12);
+    if (header.size() < 12 || !header.startsWith("RIFF") || header.mid(8, 4) != "sfbk") {
+        return false;
+    }
+
+    m_fileName = fileName;
+    m_presets.clear();
+    m_sampleBytes.clear();
+    m_presetSamples.clear();
+    m_sampleDataBytes = 0;
+
+    /* walk the LIST chunks, keeping the pdta sub-chunks and the sdta sizes */
+    QHash<QByteArray, QByteArray> pdta;
+    bool has24bit = false;
+    while (!file.atEnd()) {
+        QByteArray chunk = file.read(12);
+        if (chunk.size() < 12) {
+            break;
+        }
+        quint32 listSize = readDWord(chunk, 4);
+        qint64 listEnd = file.pos() - 4 + listSize + (listSize & 1);
+        QByteArray listType = chunk.mid(8, 4);
+        while (file.pos() + 8 <= listEnd) {
+            QByteArray sub = file.read(8);
+            if (sub.size() < 8) {
+                break;
+            }
+            quint32 subSize = readDWord(sub, 4);
+            QByteArray subId = sub.left(4);
+            if (listType == "sdta") {
+                if (subId == "smpl") {
+                    m_sampleDataBytes += subSize;
+                } else if (subId == "sm24" && subSize > 0) {
+                    m_sampleDataBytes += subSize;
+                    has24bit = true;
+                }
+                file.seek(file.pos() + subSize + (subSize & 1));
+            } else if (listType == "pdta") {
+                pdta[subId] = file.read(subSize);
+                if (subSize & 1) {
+                    file.seek(file.pos() + 1);
+                }
+            } else {
+                file.seek(file.pos() + subSize + (subSize & 1));
+            }
+        }
+        file.seek(listEnd);
+    }
+
+    const QByteArray shdr = pdta.value("shdr");
+    for (qsizetype offset = 0; offset + SHDR_SIZE <= shdr.size(); offset += SHDR_SIZE) {
+        quint32 start = readDWord(shdr, offset + 20);
+        quint32 end = readDWord(shdr, offset + 24);
+        quint16 type = readWord(shdr, offset + 44);
+        quint64 frames = (end > start && !(type & ROM_SAMPLE)) ? end - start : 0;
+        m_sampleBytes << frames * (has24bit ? 3 : 2);
+    }
+
+    const QByteArray inst = pdta.value("inst");
+    QVector<QVector<int>> instrumentSamples;
+    for (qsizetype offset = 0; offset + 2 * INST_SIZE <= inst.size(); offset += INST_SIZE) {
+        instrumentSamples << zoneTargets(pdta.value("ibag"),
+                                         pdta.value("igen"),
+                                         readWord(inst, offset + 20),
+                                         readWord(inst, offset + INST_SIZE + 20),
+                                         GEN_SAMPLEID);
+    }
+
+    /* the last record of phdr is the EOP terminator */
+    const QByteArray phdr = pdta.value("phdr");
+    for (qsizetype offset = 0; offset + 2 * PHDR_SIZE <= phdr.size(); offset += PHDR_SIZE) {
+        Preset preset;
+        preset.name = QString::fromLatin1(phdr.mid(offset, 20).constData());
+        preset.program = readWord(phdr, offset + 20);
+        preset.bank = readWord(phdr, offset + 22);
+        m_presets << preset;
+
+        QVector<int> samples;
+        const auto instruments = zoneTargets(pdta.value("pbag"),
+                                             pdta.value("pgen"),
+                                             readWord(phdr, offset + 24),
+                                             readWord(phdr, offset + PHDR_SIZE + 24),
+                                             GEN_INSTRUMENT);
+        for (int i : instruments) {
+            if (i < instrumentSamples.size()) {
+                samples << instrumentSamples[i];
+            }
+        }
+        m_presetSamples[presetKey(preset.bank, preset.program)] = samples;
+    }
+    return true;
+}
+
+QSet<int> SoundFontInfo::samplesOf(const QList<QPair<int, int>> &presets) const
+{
+    QSet<int> samples;
+    for (const auto &p : presets) {
+        const auto ids = m_presetSamples.value(presetKey(p.first, p.second));
+        for (int id : ids) {
+            samples.insert(id);
+        }
+    }
+    return samples;
+}
+
+quint64 SoundFontInfo::presetBytes(int bank, int program) const
+{
+    return residentBytes({qMakePair(bank, program)});
+}
+
+quint64 SoundFontInfo::residentBytes(const QList<QPair<int, int>> &presets) const
+{
+    quint64 bytes = 0;
+    const auto samples = samplesOf(presets);
+    for (int id : samples) {
+        if (id < m_sampleBytes.size()) {
+            bytes += m_sampleBytes[id];
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef SOUNDFONTINFO_H
+#define SOUNDFONTINFO_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+/*
+ * Sample memory accounting for a SoundFont 2 file. The FluidSynth API does not
+ * expose sample sizes, so the pdta chunk is parsed here to learn which samples
+ * each preset references, and how many bytes of sample data they need.
+ */
+class SoundFontInfo
+{
+public:
+    struct Preset
+    {
+        int bank;
+        int program;
+        QString name;
+    };
+
+    bool load(const QString &fileName);
+
+    QString fileName() const { return m_fileName; }
+    QList<Preset> presets() const { return m_presets; }
+    quint64 sampleDataBytes() const { return m_sampleDataBytes; }
+    quint64 presetBytes(int bank, int program) const;
+    quint64 residentBytes(const QList<QPair<int, int>> &presets) const;
+
+private:
+    static quint32 presetKey(int bank, int program) { return (bank << 8) | (program & 0xff); }
+    QSet<int> samplesOf(const QList<QPair<int, int>> &presets) const;
+
+    QString m_fileName;
+    QList<Preset> m_presets;
+    QVector<quint64> m_sampleBytes;
+    QHash<quint32, QVector<int>> m_presetSamples;
+    quint64 m_sampleDataBytes{0};
+};
+
+#endif // SOUNDFONTINFO_H
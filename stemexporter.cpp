@@ -0,0 +1,327 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtEndian>
+
+#include <memory>
+#include <vector>
+
+#include "stemexporter.h"
+
+/*
+ * Writes one stem as a 32 bit float stereo WAV file. The render thread queues
+ * interleaved blocks, and a pooled thread drains the queue to disk.
+ */
+class StemWriter
+{
+public:
+    static constexpr quint32 HEADER_SIZE = 58;
+
+    StemWriter(const QString &fileName, int sampleRate)
+        : m_file(fileName)
+        , m_sampleRate(sampleRate)
+    {}
+
+    bool open()
+    {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return false;
+        }
+        writeHeader();
+        return true;
+    }
+
+    void enqueue(const QByteArray &block)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_queue.size() >= StemExporter::QUEUE_LIMIT) {
+            m_notFull.wait(&m_mutex);
+        }
+        m_queue.enqueue(block);
+        m_notEmpty.wakeOne();
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_notEmpty.wakeOne();
+    }
+
+    void run()
+    {
+        forever {
+            QByteArray block;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (m_queue.isEmpty() && !m_closed) {
+                    m_notEmpty.wait(&m_mutex);
+                }
+                if (m_queue.isEmpty()) {
+                    break;
+                }
+                block = m_queue.dequeue();
+                m_notFull.wakeOne();
+            }
+            /* after a failure, the queue is still drained so the render thread does not block */
+            if (!m_failed) {
+                if (m_file.write(block) == block.size()) {
+                    m_dataSize += block.size();
+                } else {
+                    m_failed = true;
+                }
+            }
+        }
+        writeHeader();
+        m_file.close();
+    }
+
+    bool failed() const { return m_failed; }
+
+    void remove() { m_file.remove(); }
+
+private:
+    void writeHeader()
+    {
+        const quint16 channels = 2;
+        const quint16 bytesPerSample = sizeof(float);
+        const quint32 frames = m_dataSize / (channels * bytesPerSample);
+
+        m_file.seek(0);
+        QDataStream stream(&m_file);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream.writeRawData("RIFF", 4);
+        stream << quint32(HEADER_SIZE - 8 + m_dataSize);
+        stream.writeRawData("WAVE", 4);
+        stream.writeRawData("fmt ", 4);
+        stream << quint32(18);
+        stream << quint16(3); // WAVE_FORMAT_IEEE_FLOAT
+        stream << channels;
+        stream << quint32(m_sampleRate);
+        stream << quint32(m_sampleRate * channels * bytesPerSample);
+        stream << quint16(channels * bytesPerSample);
+        stream << quint16(bytesPerSample * 8);
+        stream << quint16(0);
+        stream.writeRawData("fact", 4);
+        stream << quint32(4);
+        stream << frames;
+        stream.writeRawData("data", 4);
+        stream << quint32(m_dataSize);
+        if (stream.status() != QDataStream::Ok) {
+            m_failed = true;
+        }
+        m_file.seek(HEADER_SIZE + m_dataSize);
+    }
+
+    QFile m_file;
+    int m_sampleRate;
+    quint32 m_dataSize{0};
+    bool m_closed{false};
+    bool m_failed{false};
+    QQueue<QByteArray> m_queue;
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+};
+
+struct SettingsCopy
+{
+    fluid_settings_t *source;
+    fluid_settings_t *target;
+};
+
+static void StemExporter_copy_setting(void *data, const char *name, int type)
+{
+    auto copy = static_cast<SettingsCopy *>(data);
+    switch (type) {
+    case FLUID_NUM_TYPE: {
+        double value;
+        if (fluid_settings_getnum(copy->source, name, &value) == FLUID_OK) {
+            fluid_settings_setnum(copy->target, name, value);
+        }
+        break;
+    }
+    case FLUID_INT_TYPE: {
+        int value;
+        if (fluid_settings_getint(copy->source, name, &value) == FLUID_OK) {
+            fluid_settings_setint(copy->target, name, value);
+        }
+        break;
+    }
+    case FLUID_STR_TYPE: {
+        char *value;
+        if (fluid_settings_dupstr(copy->source, name, &value) == FLUID_OK) {
+            fluid_settings_setstr(copy->target, name, value);
+            fluid_free(value);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+StemExporter::StemExporter(fluid_settings_t *settings, const QStringList &soundFonts, int groups)
+    : m_soundFonts(soundFonts)
+    , m_groups(qBound(1, groups, MAX_GROUPS))
+{
+    m_settings = new_fluid_settings();
+    SettingsCopy copy{settings, m_settings};
+    fluid_settings_foreach(settings, &copy, StemExporter_copy_setting);
+
+    fluid_settings_setint(m_settings, "synth.audio-groups", m_groups);
+    fluid_settings_setint(m_settings, "synth.audio-channels", m_groups);
+    fluid_settings_setint(m_settings, "synth.effects-groups", m_groups);
+    fluid_settings_setint(m_settings, "synth.lock-memory", 0);
+    fluid_settings_setstr(m_settings, "player.timing-source", "sample");
+}
+
+StemExporter::~StemExporter()
+{
+    delete_fluid_settings(m_settings);
+}
+
+void StemExporter::abort()
+{
+    m_aborted.store(true);
+}
+
+bool StemExporter::render(const QString &midiFile, const QString &directory)
+{
+    fluid_synth_t *synth = new_fluid_synth(m_settings);
+    if (synth == nullptr) {
+        fluid_log(FLUID_ERR, "Failed to create the stem export synthesizer");
+        return false;
+    }
+
+    foreach (const auto &fileName, m_soundFonts) {
+        if (fluid_synth_sfload(synth, fileName.toUtf8().data(), 1) == FLUID_FAILED) {
+            fluid_log(FLUID_WARN, "Stem export: failed to load the SoundFont %s", fileName.toUtf8().data());
+        }
+    }
+
+    fluid_player_t *player = new_fluid_player(synth);
+    if (player == nullptr || fluid_player_add(player, midiFile.toUtf8().data()) == FLUID_FAILED) {
+        fluid_log(FLUID_ERR, "Stem export: file cannot be played: %s", midiFile.toUtf8().data());
+        delete_fluid_player(player);
+        delete_fluid_synth(synth);
+        return false;
+    }
+
+    double sampleRate = 44100.0;
+    fluid_settings_getnum(m_settings, "synth.sample-rate", &sampleRate);
+
+    QDir dir(directory);
+    const QString baseName = QFileInfo(midiFile).completeBaseName();
+    std::vector<std::unique_ptr<StemWriter>> writers;
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_groups);
+    bool ok = true;
+    for (int group = 0; group < m_groups; ++group) {
+        const QString fileName = dir.filePath(
+            QString("%1-stem%2.wav").arg(baseName).arg(group + 1, 2, 10, QChar('0')));
+        auto writer = std::make_unique<StemWriter>(fileName, qRound(sampleRate));
+        if (!writer->open()) {
+            fluid_log(FLUID_ERR, "Stem export: cannot create %s", fileName.toUtf8().data());
+            ok = false;
+            break;
+        }
+        StemWriter *w = writer.get();
+        pool.start([w] { w->run(); });
+        writers.push_back(std::move(writer));
+    }
+
+    if (ok) {
+        /* the effects of every group are mixed into the dry buffers of the same group */
+        const int nout = m_groups * 2;
+        const int fxUnits = fluid_synth_count_effects_channels(synth);
+        const int nfx = m_groups * fxUnits * 2;
+        std::vector<float> samples(nout * PERIOD_SIZE);
+        std::vector<float *> out(nout);
+        std::vector<float *> fx(nfx);
+        for (int i = 0; i < nout; ++i) {
+            out[i] = samples.data() + i * PERIOD_SIZE;
+        }
+        for (int group = 0; group < m_groups; ++group) {
+            for (int unit = 0; unit < fxUnits; ++unit) {
+                fx[(group * fxUnits + unit) * 2] = out[group * 2];
+                fx[(group * fxUnits + unit) * 2 + 1] = out[group * 2 + 1];
+            }
+        }
+
+        /* after the song, render until the voices end and the effects have decayed */
+        const qint64 maxTailFrames = qRound64(MAX_TAIL_SECONDS * sampleRate);
+        const qint64 decayFrames = qRound64(EFFECTS_DECAY_SECONDS * sampleRate);
+        qint64 tailFrames = 0;
+        qint64 decayedFrames = 0;
+        fluid_player_play(player);
+        while (fluid_player_get_status(player) == FLUID_PLAYER_PLAYING
+               || (tailFrames < maxTailFrames && decayedFrames < decayFrames)) {
+            if (m_aborted.load()) {
+                ok = false;
+                break;
+            }
+            if (fluid_player_get_status(player) != FLUID_PLAYER_PLAYING) {
+                tailFrames += PERIOD_SIZE;
+                if (fluid_synth_get_active_voice_count(synth) > 0) {
+                    decayedFrames = 0;
+                } else {
+                    decayedFrames += PERIOD_SIZE;
+                }
+            }
+            std::fill(samples.begin(), samples.end(), 0.0f);
+            if (fluid_synth_process(synth, PERIOD_SIZE, nfx, fx.data(), nout, out.data())
+                != FLUID_OK) {
+                fluid_log(FLUID_ERR, "Stem export: synthesis failed");
+                ok = false;
+                break;
+            }
+            for (int group = 0; group < m_groups; ++group) {
+                QByteArray block(PERIOD_SIZE * 2 * sizeof(float), Qt::Uninitialized);
+                auto frames = reinterpret_cast<float *>(block.data());
+                for (int i = 0; i < PERIOD_SIZE; ++i) {
+                    frames[i * 2] = qToLittleEndian(out[group * 2][i]);
+                    frames[i * 2 + 1] = qToLittleEndian(out[group * 2 + 1][i]);
+                }
+                writers[group]->enqueue(block);
+            }
+        }
+    }
+
+    for (auto &writer : writers) {
+        writer->close();
+    }
+    pool.waitForDone();
+    for (auto &writer : writers) {
+        ok = ok && !writer->failed();
+    }
+    /* the stems of a cancelled export are incomplete */
+    if (m_aborted.load()) {
+        for (auto &writer : writers) {
+            writer->remove();
+        }
+        fluid_log(FLUID_WARN, "Stem export: cancelled, %s not exported", midiFile.toUtf8().data());
+    }
+
+    fluid_player_stop(player);
+    fluid_player_join(player);
+    delete_fluid_player(player);
+    delete_fluid_synth(synth);
+
+    if (ok) {
+        fluid_log(FLUID_INFO,
+                  "Stem export: %d stems of %s written to %s",
+                  m_groups,
+                  midiFile.toUtf8().data(),
+                  QDir::toNativeSeparators(dir.absolutePath()).toUtf8().data());
+    }
+    return ok;
+}
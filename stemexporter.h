@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2024 Pedro López-Cabanillas <plcl@users.sf.net>
+
+#ifndef STEMEXPORTER_H
+#define STEMEXPORTER_H
+
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+#include <fluidsynth.h>
+
+/*
+ * Offline renderer that writes every MIDI channel group to its own WAV file
+ * in a single pass. MIDI channel N is rendered into stem (N % groups), using
+ * the synth.audio-groups and synth.effects-groups settings of a private synth
+ * instance, so the reverb and chorus of each group are kept in its own stem.
+ */
+class StemExporter
+{
+public:
+    static constexpr int DEFAULT_GROUPS = 16;
+    static constexpr int MAX_GROUPS = 16;
+    static constexpr int PERIOD_SIZE = 512;
+    static constexpr int QUEUE_LIMIT = 64;
+    static constexpr double EFFECTS_DECAY_SECONDS = 3.0;
+    static constexpr double MAX_TAIL_SECONDS = 10.0;
+
+    StemExporter(fluid_settings_t *settings, const QStringList &soundFonts, int groups);
+    ~StemExporter();
+
+    bool render(const QString &midiFile, const QString &directory);
+    void abort();
+
+private:
+    fluid_settings_t *m_settings{nullptr};
+    QStringList m_soundFonts;
+    int m_groups{DEFAULT_GROUPS};
+    std::atomic<bool> m_aborted{false};
+};
+
+#endif // STEMEXPORTER_H